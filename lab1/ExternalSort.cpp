@@ -0,0 +1,423 @@
+#include "ExternalSort.hpp"
+#include "RadixSort.hpp"
+#include "../lab2/Arena.hpp"
+#include "../lab2/Trace.hpp"
+#include "../lab2/ThreadPool.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Желаемый минимальный размер буфера одной серии при слиянии (в элементах):
+    // по нему выбирается, сколько серий сливать за раз
+    const size_t gMinMergeBlock = 64 * 1024;
+    // Больше серий за раз не сливаем: каждая держит открытый файл
+    const size_t gMaxFanIn = 64;
+    // Потоки пула, на которых идут чтение и запись
+    const size_t gIoThreads = 4;
+
+    // Блок ключей: память берется из арены один раз, size - сколько элементов в нем сейчас лежит
+    struct Block
+    {
+        int *data;
+        size_t capacity;
+        size_t size;
+
+        Block(Arena &arena, size_t capacity) : data(arena.allocate<int>(capacity)), capacity(capacity), size(0) {}
+    };
+
+    // Файл закрывается при выходе из области видимости, в том числе по исключению
+    struct FileCloser
+    {
+        void operator()(FILE *file) const { std::fclose(file); }
+    };
+    typedef std::unique_ptr<FILE, FileCloser> File;
+
+    File open_file(const std::string &path, const char *mode)
+    {
+        File file(std::fopen(path.c_str(), mode));
+        if (!file)
+            throw std::runtime_error("Не удалось открыть файл " + path);
+        return file;
+    }
+
+    // Чтение блока большими кусками через буферизованный fread
+    size_t read_block(FILE *file, Block &block)
+    {
+        TRACE_SPAN("read block");
+        block.size = std::fread(block.data, sizeof(int), block.capacity, file);
+        if (block.size < block.capacity && std::ferror(file))
+            throw std::runtime_error("Ошибка чтения входного файла");
+        return block.size;
+    }
+
+    void write_block(FILE *file, const Block &block)
+    {
+        TRACE_SPAN("write block");
+        if (std::fwrite(block.data, sizeof(int), block.size, file) != block.size)
+            throw std::runtime_error("Ошибка записи в файл");
+    }
+
+    double seconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Временные файлы серий <выход>.runN. Все, что не удалено через remove(),
+    // удаляется в деструкторе, поэтому при ошибке на диске ничего не остается.
+    class RunFiles
+    {
+    public:
+        explicit RunFiles(const std::string &output) : output(output), next(0) {}
+
+        ~RunFiles()
+        {
+            for (size_t i = 0; i < paths.size(); ++i)
+                std::remove(paths[i].c_str());
+        }
+
+        RunFiles(const RunFiles &) = delete;
+        RunFiles &operator=(const RunFiles &) = delete;
+
+        // Путь для новой серии
+        std::string create()
+        {
+            paths.push_back(output + ".run" + std::to_string(next++));
+            return paths.back();
+        }
+
+        // Серия больше не нужна: файл удаляется
+        void remove(const std::string &path)
+        {
+            std::remove(path.c_str());
+            forget(path);
+        }
+
+        // Файл перестал быть временным (например, переименован в результат)
+        void forget(const std::string &path)
+        {
+            paths.erase(std::find(paths.begin(), paths.end(), path));
+        }
+
+    private:
+        std::string output;
+        size_t next;
+        std::vector<std::string> paths;
+    };
+
+    // Дожидается задач ввода-вывода при выходе из области видимости, в том числе
+    // по исключению: задачи пишут в блоки и файлы, объявленные раньше охраны,
+    // поэтому те не разрушаются, пока задача еще с ними работает
+    class PendingIo
+    {
+    public:
+        explicit PendingIo(std::initializer_list<std::future<void> *> futures) : futures(futures) {}
+
+        ~PendingIo()
+        {
+            for (size_t i = 0; i < futures.size(); ++i)
+                if (futures[i]->valid())
+                    futures[i]->wait();
+        }
+
+        PendingIo(const PendingIo &) = delete;
+        PendingIo &operator=(const PendingIo &) = delete;
+
+    private:
+        std::vector<std::future<void> *> futures;
+    };
+
+    // Чтение одной серии при слиянии: пока текущий блок сливается,
+    // следующий блок подчитывается задачей в пуле ввода-вывода
+    class RunReader
+    {
+    public:
+        RunReader(const std::string &path, Arena &arena, size_t block, ThreadPool &io) : file(open_file(path, "rb")), current(arena, block), next(arena, block), pos(0), io(io)
+        {
+            read_block(file.get(), current);
+            prefetch();
+        }
+
+        ~RunReader()
+        {
+            if (pending.valid())
+                pending.wait();
+        }
+
+        RunReader(const RunReader &) = delete;
+        RunReader &operator=(const RunReader &) = delete;
+
+        bool exhausted() const { return pos == current.size; }
+
+        int head() const { return current.data[pos]; }
+
+        // Переход к следующему ключу серии
+        void advance()
+        {
+            if (++pos < current.size)
+                return;
+            pending.get();
+            std::swap(current, next);
+            pos = 0;
+            if (current.size > 0)
+                prefetch();
+        }
+
+    private:
+        void prefetch()
+        {
+            pending = io.enqueue([this]
+                                 { read_block(file.get(), next); }, "read block");
+        }
+
+        File file;
+        Block current;
+        Block next;
+        size_t pos;
+        ThreadPool &io;
+        std::future<void> pending;
+    };
+
+    // Дерево проигравших для k-путевого слияния: во внутренних узлах хранятся
+    // проигравшие, в tree[0] - победитель. После выдачи ключа победителя
+    // достаточно переиграть log2(k) матчей на пути от его листа к корню.
+    class LoserTree
+    {
+    public:
+        explicit LoserTree(std::vector<std::unique_ptr<RunReader>> &runs) : runs(runs), k(runs.size()), tree(runs.size())
+        {
+            tree[0] = k > 1 ? build(1) : 0;
+        }
+
+        bool empty() const { return runs[tree[0]]->exhausted(); }
+
+        // Выдать ключ победителя и переиграть его путь до корня
+        int pop()
+        {
+            size_t w = tree[0];
+            int key = runs[w]->head();
+            runs[w]->advance();
+            for (size_t node = (w + k) / 2; node > 0; node /= 2)
+            {
+                if (less(tree[node], w))
+                    std::swap(tree[node], w);
+            }
+            tree[0] = w;
+            return key;
+        }
+
+    private:
+        // Закончившаяся серия проигрывает всем
+        bool less(size_t a, size_t b) const
+        {
+            if (runs[a]->exhausted())
+                return false;
+            if (runs[b]->exhausted())
+                return true;
+            return runs[a]->head() < runs[b]->head();
+        }
+
+        // Начальный турнир: возвращает победителя поддерева, проигравшего оставляет в узле
+        size_t build(size_t node)
+        {
+            if (node >= k)
+                return node - k;
+            size_t left = build(2 * node);
+            size_t right = build(2 * node + 1);
+            if (less(right, left))
+            {
+                tree[node] = left;
+                return right;
+            }
+            tree[node] = right;
+            return left;
+        }
+
+        std::vector<std::unique_ptr<RunReader>> &runs;
+        size_t k;
+        std::vector<size_t> tree;
+    };
+
+    // Фаза 1: чтение серий, параллельная сортировка и запись на диск.
+    // Три буфера по кругу: пока одна серия сортируется, следующая читается,
+    // а предыдущая записывается задачами в пуле ввода-вывода.
+    std::vector<std::string> make_runs(const std::string &input, RunFiles &files, size_t run_elements, Arena &arena, ThreadPool &io, uint64_t &bytes)
+    {
+        TRACE_SPAN("make runs");
+        ArenaScope scope(arena);
+        File in = open_file(input, "rb");
+        Block buffers[3] = {Block(arena, run_elements), Block(arena, run_elements), Block(arena, run_elements)};
+        Block *reading = &buffers[0], *sorting = &buffers[1], *writing = &buffers[2];
+        std::future<void> read, written;
+        PendingIo pending({&read, &written});
+        std::vector<std::string> runs;
+        bytes = 0;
+
+        read_block(in.get(), *reading);
+        while (reading->size > 0)
+        {
+            std::swap(reading, sorting);
+            FILE *source = in.get();
+            Block *target = reading;
+            read = io.enqueue([source, target]
+                              { read_block(source, *target); }, "read block");
+
+            parallel_sort(sorting->data, sorting->data + sorting->size, std::thread::hardware_concurrency(), arena);
+            bytes += sorting->size * sizeof(int);
+
+            if (written.valid())
+                written.get();
+            std::swap(sorting, writing);
+            std::string path = files.create();
+            runs.push_back(path);
+            written = io.enqueue([path, writing]
+                                 {
+                File out = open_file(path, "wb");
+                write_block(out.get(), *writing); }, "write run");
+
+            read.get();
+        }
+        if (written.valid())
+            written.get();
+        return runs;
+    }
+
+    // Сколько серий сливать за один раз, чтобы буферы по два блока на серию
+    // и на выход уложились в память и не были меньше gMinMergeBlock
+    size_t merge_fan_in(size_t memory_bytes)
+    {
+        size_t fan_in = memory_bytes / sizeof(int) / (2 * gMinMergeBlock);
+        fan_in = fan_in > 1 ? fan_in - 1 : 0;
+        if (fan_in < 2)
+            fan_in = 2;
+        if (fan_in > gMaxFanIn)
+            fan_in = gMaxFanIn;
+        return fan_in;
+    }
+
+    // Фаза 2: k-путевое слияние серий. Выходной блок записывается
+    // задачей в пуле ввода-вывода, пока заполняется следующий.
+    void merge_runs(const std::vector<std::string> &runs, RunFiles &files, const std::string &output, size_t memory_bytes, Arena &arena, ThreadPool &io)
+    {
+        TRACE_SPAN("merge runs");
+        // Каждой серии и выходу по два блока
+        size_t block = memory_bytes / sizeof(int) / (2 * (runs.size() + 1));
+        if (block == 0)
+            block = 1;
+
+        ArenaScope scope(arena);
+        std::vector<std::unique_ptr<RunReader>> readers;
+        for (size_t i = 0; i < runs.size(); ++i)
+            readers.emplace_back(new RunReader(runs[i], arena, block, io));
+
+        File out = open_file(output, "wb");
+        Block filling(arena, block), flushing(arena, block);
+        std::future<void> written;
+        PendingIo pending({&written});
+        if (!runs.empty())
+        {
+            LoserTree tree(readers);
+            while (!tree.empty())
+            {
+                int *dst = filling.data;
+                size_t n = 0;
+                while (n < block && !tree.empty())
+                    dst[n++] = tree.pop();
+                filling.size = n;
+
+                if (written.valid())
+                    written.get();
+                std::swap(filling, flushing);
+                FILE *target = out.get();
+                Block *source = &flushing;
+                written = io.enqueue([target, source]
+                                     { write_block(target, *source); }, "write block");
+            }
+        }
+        if (written.valid())
+            written.get();
+
+        readers.clear();
+        for (size_t i = 0; i < runs.size(); ++i)
+            files.remove(runs[i]);
+    }
+}
+
+// Генерация двоичного файла из count случайных 32-битных ключей
+void generate_file(const std::string &path, uint64_t count)
+{
+    Arena arena;
+    File out = open_file(path, "wb");
+    Block block(arena, 1 << 20);
+    while (count > 0)
+    {
+        block.size = count < block.capacity ? static_cast<size_t>(count) : block.capacity;
+        for (size_t i = 0; i < block.size; ++i)
+            block.data[i] = rand();
+        write_block(out.get(), block);
+        count -= block.size;
+    }
+}
+
+ExternalSortStats external_sort(const std::string &input, const std::string &output, size_t memory_bytes)
+{
+    ExternalSortStats stats = {};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    size_t run_elements = memory_bytes / 4 / sizeof(int);
+    if (run_elements == 0)
+        throw std::invalid_argument("Слишком мало памяти для внешней сортировки");
+
+    // Своя арена, а не арена потока: куски размером с бюджет памяти
+    // возвращаются системе при выходе, а не остаются за вызывающим потоком.
+    // Пул объявлен после нее: он останавливается после того, как все его задачи дождались.
+    // При исключении деструктор files удалит все оставшиеся серии
+    Arena arena;
+    ThreadPool io(gIoThreads);
+    RunFiles files(output);
+    std::vector<std::string> runs = make_runs(input, files, run_elements, arena, io, stats.bytes);
+    stats.runs = runs.size();
+    stats.runSeconds = seconds_since(start);
+
+    std::chrono::steady_clock::time_point merge_start = std::chrono::steady_clock::now();
+    // Пока серий больше, чем можно слить за раз, сливаем их группами в новые серии
+    size_t fan_in = merge_fan_in(memory_bytes);
+    while (runs.size() > fan_in)
+    {
+        std::vector<std::string> merged;
+        for (size_t first = 0; first < runs.size(); first += fan_in)
+        {
+            std::vector<std::string> group(runs.begin() + first, runs.begin() + std::min(first + fan_in, runs.size()));
+            if (group.size() == 1)
+            {
+                merged.push_back(group[0]);
+                continue;
+            }
+            merged.push_back(files.create());
+            merge_runs(group, files, merged.back(), memory_bytes, arena, io);
+        }
+        runs.swap(merged);
+        ++stats.mergePasses;
+    }
+
+    std::remove(output.c_str());
+    if (runs.size() == 1 && std::rename(runs[0].c_str(), output.c_str()) == 0)
+        files.forget(runs[0]); // Одна серия уже и есть результат
+    else
+    {
+        merge_runs(runs, files, output, memory_bytes, arena, io);
+        ++stats.mergePasses;
+    }
+    stats.arena = arena.stats();
+    stats.mergeSeconds = seconds_since(merge_start);
+    stats.seconds = seconds_since(start);
+    return stats;
+}
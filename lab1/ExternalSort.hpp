@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include "../lab2/Arena.hpp"
+
+// Статистика внешней сортировки
+struct ExternalSortStats
+{
+    uint64_t bytes;      // Объем отсортированных данных в байтах
+    size_t runs;         // Количество серий (отсортированных кусков), записанных на диск
+    double runSeconds;   // Время формирования серий
+    size_t mergePasses;  // Сколько проходов слияния понадобилось
+    double mergeSeconds; // Время k-путевого слияния серий
+    double seconds;      // Общее время сортировки
+    ArenaStats arena;    // Выделения из арены сортировки
+};
+
+// Генерация двоичного файла из count случайных 32-битных ключей
+void generate_file(const std::string &path, uint64_t count);
+
+// Внешняя сортировка двоичного файла 32-битных ключей, который не помещается в память.
+// memory_bytes - сколько памяти можно занять: входной файл режется на серии
+// размером в четверть этого объема (одна серия читается, одна сортируется вместе
+// с рабочим буфером того же размера, одна пишется), серии сортируются параллельной
+// поразрядной сортировкой и сливаются через дерево проигравших, не больше 64 за раз
+// (если серий больше, слияние идет в несколько проходов). Чтение и запись идут
+// задачами в небольшом пуле потоков. Вся память берется из собственной арены
+// сортировки и возвращается системе до выхода из функции.
+ExternalSortStats external_sort(const std::string &input, const std::string &output, size_t memory_bytes);
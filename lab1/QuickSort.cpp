@@ -0,0 +1,47 @@
+#include "QuickSort.hpp"
+#include <future>
+#include <algorithm>
+
+// Функция для разделения массива (часть алгоритма быстрой сортировки)
+int partition(std::vector<int> &arr, int low, int high)
+{
+    int pivot = arr[high]; // выбираем последний элемент как опорный
+    int i = low - 1;       // индекс меньших элементов
+    for (int j = low; j < high; j++)
+    {
+        if (arr[j] < pivot)
+        { // если текущий элемент меньше опорного
+            i++;
+            std::swap(arr[i], arr[j]); // меняем элементы местами
+        }
+    }
+    std::swap(arr[i + 1], arr[high]); // ставим опорный элемент на место
+    return i + 1;                     // возвращаем индекс опорного элемента
+}
+
+// Рекурсивная функция для быстрой сортировки
+void quick_sort(std::vector<int> &arr, int low, int high)
+{
+    if (low < high)
+    {
+        int pi = partition(arr, low, high); // разбиваем массив на две части
+
+        // Рекурсивно сортируем левую часть
+        quick_sort(arr, low, pi - 1);
+
+        // Рекурсивно сортируем правую часть
+        quick_sort(arr, pi + 1, high);
+    }
+}
+
+// Асинхронная версия быстрой сортировки с использованием потоков
+void quick_sort_async(std::vector<int> &arr, int low, int high)
+{
+    if (low < high)
+    {
+        int pi = partition(arr, low, high);
+        std::future<void> left_sort = std::async(std::launch::async, quick_sort, std::ref(arr), pi + 1, high);
+        quick_sort_async(arr, low, pi - 1);
+        left_sort.get();
+    }
+}
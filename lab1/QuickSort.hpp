@@ -0,0 +1,11 @@
+#pragma once
+#include <vector>
+
+// Функция для разделения массива (часть алгоритма быстрой сортировки)
+int partition(std::vector<int> &arr, int low, int high);
+
+// Рекурсивная функция для быстрой сортировки
+void quick_sort(std::vector<int> &arr, int low, int high);
+
+// Асинхронная версия быстрой сортировки с использованием потоков
+void quick_sort_async(std::vector<int> &arr, int low, int high);
@@ -0,0 +1,272 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../lab2/Arena.hpp"
+#include "../lab2/Trace.hpp"
+
+// Поразрядная (LSD) сортировка для целочисленных ключей.
+// Каждый проход раскладывает элементы по очередному байту ключа:
+// потоки считают гистограммы своих кусков, префиксные суммы дают каждому
+// потоку его позиции в выходном массиве, а раскладка идет через небольшие
+// буферы на каждую корзину (программное объединение записей), чтобы в память
+// уходили целые строки кэша, а не по одному элементу в 256 разных мест.
+
+// Как достать целочисленный ключ из элемента. value == false - ключа нет,
+// такой тип сортируется сравнением.
+template <typename T, typename Enable = void>
+struct RadixKey
+{
+    static const bool value = false;
+};
+
+template <typename T>
+struct RadixKey<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type>
+{
+    static const bool value = true;
+    typedef T key_type;
+    static key_type get(const T &x) { return x; }
+};
+
+// Пара ключ/значение сортируется по ключу, значение переезжает вместе с ним.
+// Ключ - только целое число, вложенные пары сортируются сравнением
+template <typename K, typename V>
+struct RadixKey<std::pair<K, V>, typename std::enable_if<std::is_integral<K>::value && !std::is_same<K, bool>::value>::type>
+{
+    static const bool value = true;
+    typedef K key_type;
+    static key_type get(const std::pair<K, V> &x) { return x.first; }
+};
+
+namespace radix_detail
+{
+    const size_t gBuckets = 256;
+    // Меньше этого размера потоки не окупаются
+    const size_t gMinPerThread = 64 * 1024;
+    // Ниже этого размера проще отсортировать сравнением
+    const size_t gMinRadix = 256;
+
+    // Байт ключа с номером pass; у знаковых ключей инвертируем старший бит,
+    // чтобы отрицательные числа шли раньше положительных
+    template <typename K>
+    inline size_t digit(K key, size_t pass)
+    {
+        typedef typename std::make_unsigned<K>::type U;
+        U u = static_cast<U>(key);
+        if (std::is_signed<K>::value)
+            u ^= U(1) << (sizeof(K) * 8 - 1);
+        return static_cast<size_t>(u >> (pass * 8)) & (gBuckets - 1);
+    }
+
+    template <typename T>
+    void histogram(const T *data, size_t begin, size_t end, size_t pass, size_t *count)
+    {
+        TRACE_SPAN("radix histogram");
+        std::fill(count, count + gBuckets, size_t(0));
+        for (size_t i = begin; i < end; ++i)
+            ++count[digit(RadixKey<T>::get(data[i]), pass)];
+    }
+
+    // Сколько элементов помещается в строку кэша
+    template <typename T>
+    inline size_t line_size()
+    {
+        return 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+    }
+
+    // Сколько элементов записать в корзину, чтобы ее следующая запись в dst
+    // начиналась с границы строки кэша. Если размер элемента не делит строку,
+    // выровнять нельзя, и сбрасываем сразу целыми строками.
+    template <typename T>
+    inline size_t first_flush(const T *dst)
+    {
+        const size_t line = line_size<T>();
+        if (64 % sizeof(T) != 0)
+            return line;
+        size_t misaligned = reinterpret_cast<uintptr_t>(dst) % 64 / sizeof(T);
+        return misaligned ? line - misaligned : line;
+    }
+
+    // Раскладка куска [begin, end) по корзинам. offset[d] - куда писать
+    // следующий элемент корзины d. Элементы копятся в buffer (по строке кэша
+    // на корзину) и сбрасываются в dst целиком. Первый сброс корзины короче -
+    // до границы строки, поэтому все последующие ложатся на целые строки.
+    template <typename T>
+    void scatter(const T *src, T *dst, size_t begin, size_t end, size_t pass, size_t *offset, T *buffer)
+    {
+        TRACE_SPAN("radix scatter");
+        const size_t line = line_size<T>();
+        size_t fill[gBuckets] = {};
+        size_t limit[gBuckets];
+        for (size_t d = 0; d < gBuckets; ++d)
+            limit[d] = first_flush(dst + offset[d]);
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            size_t d = digit(RadixKey<T>::get(src[i]), pass);
+            buffer[d * line + fill[d]] = src[i];
+            if (++fill[d] == limit[d])
+            {
+                std::copy(&buffer[d * line], &buffer[d * line] + fill[d], dst + offset[d]);
+                offset[d] += fill[d];
+                fill[d] = 0;
+                limit[d] = line;
+            }
+        }
+        for (size_t d = 0; d < gBuckets; ++d)
+        {
+            std::copy(&buffer[d * line], &buffer[d * line] + fill[d], dst + offset[d]);
+            offset[d] += fill[d];
+        }
+    }
+
+    // Рабочая память под элементы. Арена не вызывает конструкторов, поэтому
+    // годится только для тривиально копируемых типов; остальные (например,
+    // pair<int, string>) получают вектор с построенными элементами.
+    template <typename T, bool Trivial = std::is_trivially_copyable<T>::value>
+    struct Scratch
+    {
+        static T *get(Arena &arena, size_t n, size_t align, std::vector<T> &)
+        {
+            return static_cast<T *>(arena.allocate(n * sizeof(T), align));
+        }
+    };
+
+    template <typename T>
+    struct Scratch<T, false>
+    {
+        static T *get(Arena &, size_t n, size_t, std::vector<T> &storage)
+        {
+            storage.resize(n);
+            return storage.data();
+        }
+    };
+
+    // Параллельная LSD-сортировка data с использованием tmp того же размера.
+    // Гистограммы и буферы раскладки всех потоков берутся из arena вызывающего потока.
+    template <typename T>
+    void radix_sort(T *data, T *tmp, size_t n, size_t threads, Arena &arena)
+    {
+        typedef typename RadixKey<T>::key_type K;
+
+        if (threads > n / gMinPerThread)
+            threads = n / gMinPerThread;
+        if (threads == 0)
+            threads = 1;
+
+        size_t *bounds = arena.allocate<size_t>(threads + 1);
+        for (size_t t = 0; t <= threads; ++t)
+            bounds[t] = n * t / threads;
+        size_t *counts = arena.allocate<size_t>(threads * gBuckets);
+        const size_t buffer = gBuckets * line_size<T>();
+        std::vector<T> storage;
+        T *buffers = Scratch<T>::get(arena, threads * buffer, 64, storage);
+
+        T *src = data, *dst = tmp;
+        for (size_t pass = 0; pass < sizeof(K); ++pass)
+        {
+            // Гистограммы по кускам: поток t считает свой кусок
+            std::vector<std::future<void>> jobs;
+            for (size_t t = 1; t < threads; ++t)
+                jobs.push_back(std::async(std::launch::async, histogram<T>, src, bounds[t], bounds[t + 1], pass, &counts[t * gBuckets]));
+            histogram(src, bounds[0], bounds[1], pass, &counts[0]);
+            for (size_t t = 0; t < jobs.size(); ++t)
+                jobs[t].get();
+
+            // Если все ключи попали в одну корзину, проход ничего не меняет
+            bool trivial = false;
+            for (size_t d = 0; d < gBuckets && !trivial; ++d)
+            {
+                size_t total = 0;
+                for (size_t t = 0; t < threads; ++t)
+                    total += counts[t * gBuckets + d];
+                trivial = total == n;
+            }
+            if (trivial)
+                continue;
+
+            // Префиксные суммы: сначала по корзинам, внутри корзины - по потокам,
+            // так раскладка остается устойчивой
+            size_t sum = 0;
+            for (size_t d = 0; d < gBuckets; ++d)
+            {
+                for (size_t t = 0; t < threads; ++t)
+                {
+                    size_t c = counts[t * gBuckets + d];
+                    counts[t * gBuckets + d] = sum;
+                    sum += c;
+                }
+            }
+
+            jobs.clear();
+            for (size_t t = 1; t < threads; ++t)
+                jobs.push_back(std::async(std::launch::async, scatter<T>, src, dst, bounds[t], bounds[t + 1], pass, &counts[t * gBuckets], &buffers[t * buffer]));
+            scatter(src, dst, bounds[0], bounds[1], pass, &counts[0], &buffers[0]);
+            for (size_t t = 0; t < jobs.size(); ++t)
+                jobs[t].get();
+
+            std::swap(src, dst);
+        }
+
+        if (src != data)
+            std::copy(src, src + n, data);
+    }
+}
+
+// Движок сортировки. Общий случай - сравнительная сортировка.
+template <typename T, bool Radix = RadixKey<T>::value>
+struct SortEngine
+{
+    static void sort(T *first, T *last, size_t, Arena &)
+    {
+        std::sort(first, last);
+    }
+};
+
+// Для целочисленных ключей (и пар с целочисленным ключом) - поразрядная сортировка
+template <typename T>
+struct SortEngine<T, true>
+{
+    static void sort(T *first, T *last, size_t threads, Arena &arena)
+    {
+        size_t n = last - first;
+        if (n < radix_detail::gMinRadix)
+        {
+            std::stable_sort(first, last, [](const T &a, const T &b)
+                             { return RadixKey<T>::get(a) < RadixKey<T>::get(b); });
+            return;
+        }
+        TRACE_SPAN("radix sort");
+        // Рабочий буфер и гистограммы - из арены, после сортировки она откатывается
+        ArenaScope scope(arena);
+        std::vector<T> storage;
+        T *tmp = radix_detail::Scratch<T>::get(arena, n, alignof(T), storage);
+        radix_detail::radix_sort(first, tmp, n, threads, arena);
+    }
+};
+
+// Параллельная сортировка: движок выбирается по типу элемента.
+// Рабочая память берется из arena; куски остаются за ней и после сортировки
+template <typename T>
+void parallel_sort(T *first, T *last, size_t threads, Arena &arena)
+{
+    SortEngine<T>::sort(first, last, threads, arena);
+}
+
+// То же с ареной текущего потока
+template <typename T>
+void parallel_sort(T *first, T *last, size_t threads = std::thread::hardware_concurrency())
+{
+    parallel_sort(first, last, threads, threadArena());
+}
+
+template <typename T>
+void parallel_sort(std::vector<T> &arr, size_t threads = std::thread::hardware_concurrency())
+{
+    parallel_sort(arr.data(), arr.data() + arr.size(), threads);
+}
@@ -1,6 +1,8 @@
 #!/bin/bash
 
-g++ *.cpp -o program.out && ./program.out
+g++ -std=c++11 -O2 -pthread ${TRACE:+-DENABLE_TRACE} *.cpp ../lab2/ThreadPool.cpp -o program.out && ./program.out "$@"
 
 
-# run: bash ./compiler.sh
\ No newline at end of file
+# run: bash ./compiler.sh
+# внешняя сортировка: bash ./compiler.sh external <вход> <выход> [память в МБ]
+# трассировка: TRACE=1 bash ./compiler.sh --trace trace.json radix 1000000
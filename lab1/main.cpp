@@ -3,6 +3,13 @@
 #include <vector>
 #include <algorithm>
 #include <ctime>
+#include <chrono>
+#include <string>
+#include "QuickSort.hpp"
+#include "ExternalSort.hpp"
+#include "RadixSort.hpp"
+#include "../lab2/Arena.hpp"
+#include "../lab2/Trace.hpp"
 
 using namespace std;
 
@@ -10,14 +17,11 @@ const size_t gCount = 100; // количество элементов в мас
 const size_t gThreads = 4; // количество используемых потоков
 
 void init_array(std::vector<int> &arr, int max_element);
-double getAVG(vector<double> elements);
+double getAVG(const vector<double> &elements, bool f);
 void testTimeSync(int size);
 void testTimeAsync(int size);
-double getTimeSync(int size);
-double getTimeAsync(int size);
-int partition(std::vector<int> &arr, int low, int high);
-void quick_sort(std::vector<int> &arr, int low, int high);
-void quick_sort_async(std::vector<int> &arr, int low, int high);
+double getTimeSync(vector<int> &elements);
+double getTimeAsync(vector<int> &elements);
 
 // Инициализация массива случайными числами
 void init_array(std::vector<int> &arr, int max_element)
@@ -28,7 +32,7 @@ void init_array(std::vector<int> &arr, int max_element)
     }
 }
 
-double getAVG(vector<double> elements, bool f)
+double getAVG(const vector<double> &elements, bool f)
 {
     double sum = 0;
     size_t size = elements.size();
@@ -42,12 +46,15 @@ double getAVG(vector<double> elements, bool f)
         return sum / size * 2;
 }
 
+// Массив и вектор замеров выделяются один раз на все 20 тестов
 void testTimeSync(int size)
 {
+    vector<int> elements(size);
     vector<double> times;
+    times.reserve(20);
     for (size_t i = 0; i < 20; i++)
     {
-        double time = getTimeSync(size);
+        double time = getTimeSync(elements);
         cout << time << " ";
         times.push_back(time);
     }
@@ -56,29 +63,31 @@ void testTimeSync(int size)
 
 void testTimeAsync(int size)
 {
+    vector<int> elements(size);
     vector<double> times;
+    times.reserve(20);
     for (size_t i = 0; i < 20; i++)
     {
-        double time = getTimeAsync(size);
+        double time = getTimeAsync(elements);
         cout << time << " ";
         times.push_back(time);
     }
     cout << "\nТесты скорости Aсинхронной сортировки: " << getAVG(times, true);
 }
 
-double getTimeAsync(int size)
+double getTimeAsync(vector<int> &elements)
 {
-    vector<int> elements(size);
-    init_array(elements, size);
+    fill(elements.begin(), elements.end(), 0);
+    init_array(elements, elements.size());
     clock_t time_start = clock();
     quick_sort_async(elements, 0, elements.size() - 1);
     double elapsed_time = (double(clock() - time_start)) / CLOCKS_PER_SEC;
     return elapsed_time;
 }
 
-double getTimeSync(int size)
+double getTimeSync(vector<int> &elements)
 {
-    vector<int> elements(size);
+    fill(elements.begin(), elements.end(), 0);
     init_array(elements, 100);
     clock_t time_start = clock();
     quick_sort(elements, 0, elements.size() - 1);
@@ -87,52 +96,101 @@ double getTimeSync(int size)
     return elapsed_time;
 }
 
-// Функция для разделения массива (часть алгоритма быстрой сортировки)
-int partition(std::vector<int> &arr, int low, int high)
+// Сколько памяти движки сортировки взяли повторно из арены вместо malloc
+void printArenaStats(const ArenaStats &stats)
 {
-    int pivot = arr[high]; // выбираем последний элемент как опорный
-    int i = low - 1;       // индекс меньших элементов
-    for (int j = low; j < high; j++)
-    {
-        if (arr[j] < pivot)
-        { // если текущий элемент меньше опорного
-            i++;
-            std::swap(arr[i], arr[j]); // меняем элементы местами
-        }
-    }
-    std::swap(arr[i + 1], arr[high]); // ставим опорный элемент на место
-    return i + 1;                     // возвращаем индекс опорного элемента
+    cout << "Арена: выделений " << stats.allocations << ", вызовов malloc " << stats.mallocCalls
+         << ", без malloc " << stats.mallocAvoided << ", переиспользовано " << stats.bytesReused / (1024.0 * 1024.0) << " МБ\n";
 }
 
-// Рекурсивная функция для быстрой сортировки
-void quick_sort(std::vector<int> &arr, int low, int high)
+// Режим внешней сортировки: файл целиком в память не помещается
+int runExternalSort(const string &input, const string &output, size_t memory_mb)
 {
-    if (low < high)
+    ExternalSortStats stats;
+    try
     {
-        int pi = partition(arr, low, high); // разбиваем массив на две части
-
-        // Рекурсивно сортируем левую часть
-        quick_sort(arr, low, pi - 1);
-
-        // Рекурсивно сортируем правую часть
-        quick_sort(arr, pi + 1, high);
+        stats = external_sort(input, output, memory_mb * 1024 * 1024);
+    }
+    catch (const exception &e)
+    {
+        cerr << e.what() << endl;
+        return 1;
     }
+    double mb = stats.bytes / (1024.0 * 1024.0);
+    cout << "Отсортировано " << mb << " МБ, серий: " << stats.runs << ", проходов слияния: " << stats.mergePasses << "\n";
+    cout << "Формирование серий: " << stats.runSeconds << " с, слияние: " << stats.mergeSeconds << " с\n";
+    cout << "Всего: " << stats.seconds << " с, " << mb / stats.seconds << " МБ/с\n";
+    printArenaStats(stats.arena);
+    return 0;
 }
 
-// Асинхронная версия быстрой сортировки с использованием потоков
-void quick_sort_async(std::vector<int> &arr, int low, int high)
+// Сравнение параллельной быстрой сортировки и поразрядной на count случайных числах
+int runRadixCompare(size_t count)
 {
-    if (low < high)
+    vector<int> quick(count);
+    for (size_t i = 0; i < count; i++)
+        quick[i] = rand();
+    vector<int> radix(quick);
+    vector<pair<int, int>> pairs(count);
+    for (size_t i = 0; i < count; i++)
+        pairs[i] = make_pair(quick[i], int(i));
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    quick_sort_async(quick, 0, int(count) - 1);
+    double quick_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    parallel_sort(radix);
+    double radix_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    parallel_sort(pairs);
+    double pairs_time = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Быстрая сортировка: " << quick_time << " с\n";
+    cout << "Поразрядная сортировка: " << radix_time << " с (в " << quick_time / radix_time << " раз быстрее)\n";
+    cout << "Поразрядная сортировка пар ключ/значение: " << pairs_time << " с\n";
+    printArenaStats(threadArena().stats());
+    if (quick != radix)
     {
-        int pi = partition(arr, low, high);
-        std::future<void> left_sort = std::async(std::launch::async, quick_sort, std::ref(arr), pi + 1, high);
-        quick_sort_async(arr, low, pi - 1);
-        left_sort.get();
+        cerr << "Результаты сортировок не совпадают!" << endl;
+        return 1;
     }
+    return 0;
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+    // ./program.out --trace <файл> <режим...>: при сборке с TRACE=1 записать
+    // трассировку сортировки в формате Chrome trace
+    string tracePath;
+    if (argc >= 3 && string(argv[1]) == "--trace")
+    {
+        tracePath = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+    TRACE_SESSION(tracePath);
+    TRACE_THREAD_NAME("main");
+
+    // ./program.out generate <файл> <количество ключей>
+    if (argc == 4 && string(argv[1]) == "generate")
+    {
+        generate_file(argv[2], stoull(argv[3]));
+        return 0;
+    }
+
+    // ./program.out radix <количество элементов>
+    if (argc == 3 && string(argv[1]) == "radix")
+        return runRadixCompare(stoull(argv[2]));
+
+    // ./program.out external <вход> <выход> [память в МБ]
+    if ((argc == 4 || argc == 5) && string(argv[1]) == "external")
+    {
+        size_t memory_mb = argc == 5 ? stoul(argv[4]) : 1024;
+        return runExternalSort(argv[2], argv[3], memory_mb);
+    }
+
     int size1 = 100;
     int size2 = 10000;
 
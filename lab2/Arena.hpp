@@ -0,0 +1,386 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Статистика повторного использования памяти
+struct ArenaStats
+{
+    size_t allocations;    // Сколько раз выдавалась память
+    size_t mallocCalls;    // Сколько раз пришлось обратиться к malloc
+    size_t mallocAvoided;  // Сколько выдач обошлись без malloc
+    size_t bytesAllocated; // Сколько байт выдано всего
+    size_t bytesReused;    // Сколько из них пришлось на память, уже выдававшуюся раньше
+
+    ArenaStats() : allocations(0), mallocCalls(0), mallocAvoided(0), bytesAllocated(0), bytesReused(0) {}
+
+    ArenaStats &operator+=(const ArenaStats &other)
+    {
+        allocations += other.allocations;
+        mallocCalls += other.mallocCalls;
+        mallocAvoided += other.mallocAvoided;
+        bytesAllocated += other.bytesAllocated;
+        bytesReused += other.bytesReused;
+        return *this;
+    }
+};
+
+// Счетчик, который пишет только поток-владелец, а читать можно из любого потока
+class StatCounter
+{
+public:
+    StatCounter() : value(0) {}
+
+    void add(size_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    size_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<size_t> value;
+};
+
+// Арена для временных буферов: память выдается сдвигом указателя внутри
+// больших кусков, а reset() или rewind() возвращают ее всю разом без free.
+// Куски остаются у арены, поэтому следующий пакет работы обходится без malloc.
+// Не потокобезопасна: у каждого потока своя арена (см. threadArena()).
+class Arena
+{
+public:
+    // Позиция в арене, к которой можно откатиться
+    struct Marker
+    {
+        size_t chunk;
+        size_t offset;
+    };
+
+    explicit Arena(size_t chunkSize = 1 << 20) : chunkSize(chunkSize), current(0) {}
+
+    ~Arena() { release(); }
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // Выделение bytes байт с выравниванием align. Конструкторы не вызываются,
+    // арена предназначена для буферов простых типов.
+    void *allocate(size_t bytes, size_t align = alignof(std::max_align_t))
+    {
+        allocations.add(1);
+        bytesAllocated.add(bytes);
+        for (; current < chunks.size(); ++current)
+        {
+            void *ptr = take(chunks[current], bytes, align);
+            if (ptr)
+            {
+                mallocAvoided.add(1);
+                return ptr;
+            }
+        }
+
+        size_t size = bytes + align > chunkSize ? bytes + align : chunkSize;
+        Chunk chunk = {static_cast<char *>(std::malloc(size)), size, 0, 0};
+        if (!chunk.data)
+            throw std::bad_alloc();
+        mallocCalls.add(1);
+        chunks.push_back(chunk);
+        current = chunks.size() - 1;
+        return take(chunks[current], bytes, align);
+    }
+
+    template <typename T>
+    T *allocate(size_t count)
+    {
+        return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    Marker mark() const
+    {
+        Marker marker = {current, current < chunks.size() ? chunks[current].used : 0};
+        return marker;
+    }
+
+    // Откат к позиции marker: все, что выделено после нее, снова свободно
+    void rewind(Marker marker)
+    {
+        for (size_t i = marker.chunk; i < chunks.size(); ++i)
+            chunks[i].used = i == marker.chunk ? marker.offset : 0;
+        current = marker.chunk;
+    }
+
+    // Сброс арены между пакетами работы; память остается за ареной
+    void reset()
+    {
+        Marker start = {0, 0};
+        rewind(start);
+    }
+
+    // Вернуть все куски системе
+    void release()
+    {
+        for (size_t i = 0; i < chunks.size(); ++i)
+            std::free(chunks[i].data);
+        chunks.clear();
+        current = 0;
+    }
+
+    ArenaStats stats() const
+    {
+        ArenaStats result;
+        result.allocations = allocations.get();
+        result.mallocCalls = mallocCalls.get();
+        result.mallocAvoided = mallocAvoided.get();
+        result.bytesAllocated = bytesAllocated.get();
+        result.bytesReused = bytesReused.get();
+        return result;
+    }
+
+private:
+    struct Chunk
+    {
+        char *data;
+        size_t size;
+        size_t used; // Сколько байт занято сейчас
+        size_t peak; // Сколько байт когда-либо занимали: все, что ниже, - повторное использование
+    };
+
+    void *take(Chunk &chunk, size_t bytes, size_t align)
+    {
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data);
+        size_t offset = ((base + chunk.used + align - 1) & ~(uintptr_t(align) - 1)) - base;
+        if (offset + bytes > chunk.size)
+            return nullptr;
+        if (offset < chunk.peak)
+            bytesReused.add((offset + bytes < chunk.peak ? offset + bytes : chunk.peak) - offset);
+        chunk.used = offset + bytes;
+        if (chunk.used > chunk.peak)
+            chunk.peak = chunk.used;
+        return chunk.data + offset;
+    }
+
+    size_t chunkSize;
+    std::vector<Chunk> chunks;
+    size_t current; // Кусок, из которого сейчас идет выделение
+
+    StatCounter allocations;
+    StatCounter mallocCalls;
+    StatCounter mallocAvoided;
+    StatCounter bytesAllocated;
+    StatCounter bytesReused;
+};
+
+// Откат арены при выходе из области видимости: временные буферы,
+// выделенные внутри, освобождаются, а выделенное раньше остается
+class ArenaScope
+{
+public:
+    explicit ArenaScope(Arena &arena) : arena(arena), marker(arena.mark()) {}
+    ~ArenaScope() { arena.rewind(marker); }
+
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+private:
+    Arena &arena;
+    Arena::Marker marker;
+};
+
+// Арена текущего потока
+inline Arena &threadArena()
+{
+    static thread_local Arena arena;
+    return arena;
+}
+
+// Пул объектов одного типа со списком свободных ячеек: release() кладет
+// ячейку в список, acquire() берет ее оттуда вместо нового выделения.
+// Не потокобезопасен, синхронизация - на стороне владельца.
+template <typename T>
+class ObjectPool
+{
+public:
+    ObjectPool() : freeList(nullptr) {}
+
+    ~ObjectPool()
+    {
+        while (freeList)
+        {
+            Slot *next = freeList->next;
+            ::operator delete(freeList);
+            freeList = next;
+        }
+    }
+
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    template <typename... Args>
+    T *acquire(Args &&...args)
+    {
+        void *memory;
+        allocations.add(1);
+        bytesAllocated.add(sizeof(Slot));
+        if (freeList)
+        {
+            memory = freeList;
+            freeList = freeList->next;
+            mallocAvoided.add(1);
+            bytesReused.add(sizeof(Slot));
+        }
+        else
+        {
+            memory = ::operator new(sizeof(Slot));
+            mallocCalls.add(1);
+        }
+        return new (memory) T(std::forward<Args>(args)...);
+    }
+
+    void release(T *object)
+    {
+        object->~T();
+        Slot *slot = reinterpret_cast<Slot *>(object);
+        slot->next = freeList;
+        freeList = slot;
+    }
+
+    ArenaStats stats() const
+    {
+        ArenaStats result;
+        result.allocations = allocations.get();
+        result.mallocCalls = mallocCalls.get();
+        result.mallocAvoided = mallocAvoided.get();
+        result.bytesAllocated = bytesAllocated.get();
+        result.bytesReused = bytesReused.get();
+        return result;
+    }
+
+private:
+    union Slot
+    {
+        Slot *next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    Slot *freeList;
+
+    StatCounter allocations;
+    StatCounter mallocCalls;
+    StatCounter mallocAvoided;
+    StatCounter bytesAllocated;
+    StatCounter bytesReused;
+};
+
+// Пул блоков фиксированного размера, общий для нескольких потоков: блок может
+// вернуть не тот поток, который его взял (например, общее состояние future
+// освобождает последний из promise и future). Запросы больше блока идут
+// в operator new и считаются как вызовы malloc.
+class BlockPool
+{
+public:
+    explicit BlockPool(size_t blockSize) : blockSize(blockSize < sizeof(Node) ? sizeof(Node) : blockSize), freeList(nullptr) {}
+
+    ~BlockPool()
+    {
+        while (freeList)
+        {
+            Node *next = freeList->next;
+            ::operator delete(freeList);
+            freeList = next;
+        }
+    }
+
+    BlockPool(const BlockPool &) = delete;
+    BlockPool &operator=(const BlockPool &) = delete;
+
+    void *allocate(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        allocations.add(1);
+        bytesAllocated.add(bytes);
+        if (bytes <= blockSize && freeList)
+        {
+            Node *node = freeList;
+            freeList = node->next;
+            mallocAvoided.add(1);
+            bytesReused.add(bytes);
+            return node;
+        }
+        mallocCalls.add(1);
+        return ::operator new(bytes <= blockSize ? blockSize : bytes);
+    }
+
+    void deallocate(void *ptr, size_t bytes)
+    {
+        if (bytes > blockSize)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        Node *node = static_cast<Node *>(ptr);
+        node->next = freeList;
+        freeList = node;
+    }
+
+    ArenaStats stats() const
+    {
+        ArenaStats result;
+        result.allocations = allocations.get();
+        result.mallocCalls = mallocCalls.get();
+        result.mallocAvoided = mallocAvoided.get();
+        result.bytesAllocated = bytesAllocated.get();
+        result.bytesReused = bytesReused.get();
+        return result;
+    }
+
+private:
+    struct Node
+    {
+        Node *next;
+    };
+
+    size_t blockSize;
+    Node *freeList;
+    std::mutex mutex;
+
+    // Пишутся только под mutex
+    StatCounter allocations;
+    StatCounter mallocCalls;
+    StatCounter mallocAvoided;
+    StatCounter bytesAllocated;
+    StatCounter bytesReused;
+};
+
+// Аллокатор поверх BlockPool для std::promise и стандартных контейнеров.
+// Пул должен пережить все выделенные из него блоки.
+template <typename T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit PoolAllocator(BlockPool &pool) : pool(&pool) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : pool(other.pool) {}
+
+    T *allocate(size_t n) { return static_cast<T *>(pool->allocate(n * sizeof(T))); }
+    void deallocate(T *ptr, size_t n) { pool->deallocate(ptr, n * sizeof(T)); }
+
+    BlockPool *pool;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &a, const PoolAllocator<U> &b)
+{
+    return a.pool == b.pool;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &a, const PoolAllocator<U> &b)
+{
+    return a.pool != b.pool;
+}
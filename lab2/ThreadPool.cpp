@@ -1,55 +1,141 @@
 #include "ThreadPool.hpp"
 
-void ThreadPool::run()
+// Размер блока под общее состояние future и его результат
+const size_t gStateBlock = 64;
+
+// Задачи могут брать временные буферы из threadArena(): арена рабочего
+// потока сбрасывается после каждой задачи
+void ThreadPool::run(size_t index)
 {
+    TRACE_THREAD_NAME("worker " + std::to_string(index));
+    Arena &arena = threadArena();
+    Task *done = nullptr;
+
     while (true)
     {
-        std::function<void()> task;
-        
+        Task *task = nullptr;
+
         {
             std::unique_lock<std::mutex> lock(queueMutex);
+            // Ячейку выполненной задачи возвращаем в пул под той же блокировкой,
+            // под которой берем следующую задачу
+            if (done)
+            {
+                taskPool.release(done);
+                done = nullptr;
+            }
             condition.wait(lock, [this]
                            { return stop || !tasks.empty(); });
             if (stop || tasks.empty())
                 return;
             if (!tasks.empty())
             {
-                task = std::move(tasks.front());
+                task = tasks.front();
                 tasks.pop();
             }
         }
 
         if (task)
         {
-            task();
+            TRACE_EVENT(START, task->label, task->id);
+            (*task)();
+            TRACE_EVENT(END, task->label, task->id);
+            // Замыкание задачи разрушаем здесь, а не под блокировкой очереди
+            task->clear();
+            arena.reset();
+            done = task;
         }
     }
 }
 
 
-// Метод для добавления задачи в пул и получения результата через future
-std::future<void> ThreadPool::enqueue(std::function<void()> task)
+// Постановка готовой задачи в очередь: ячейка берется из пула,
+// замыкание переносится в нее под блокировкой очереди
+void ThreadPool::push(Task &&task)
 {
-    auto taskPtr = std::make_shared<std::packaged_task<void()>>(std::move(task));
-    std::future<void> res = taskPtr->get_future();
-
     {
         std::lock_guard<std::mutex> lock(queueMutex);
         if (stop)
             throw std::runtime_error("enqueue on stopped ThreadPool");
-        tasks.emplace([taskPtr]()
-                      { (*taskPtr)(); });
+        if (!task.inlined())
+            heapClosures.add(1);
+        tasks.push(taskPool.acquire(std::move(task)));
     }
     condition.notify_one();
-    return res;
 }
 
+// Повторное использование ячеек очереди задач вместе с замыканиями в них
+ArenaStats ThreadPool::slotStats()
+{
+    std::lock_guard<std::mutex> lock(queueMutex);
+    ArenaStats result = taskPool.stats();
+    result.allocations += heapClosures.get();
+    result.mallocCalls += heapClosures.get();
+    return result;
+}
+
+// Повторное использование общих состояний future
+ArenaStats ThreadPool::stateStats()
+{
+    return statePool().stats();
+}
+
+// Пул никогда не разрушается: future может пережить и свой ThreadPool,
+// и статические объекты, а его блок вернется в пул при разрушении future
+BlockPool &ThreadPool::statePool()
+{
+    static BlockPool *pool = new BlockPool(gStateBlock);
+    return *pool;
+}
+
+ThreadPool::Task::Task(Task &&other)
+    : label(other.label), id(other.id), closure(nullptr), call(other.call), move(other.move), destroy(other.destroy), promise(std::move(other.promise))
+{
+    if (!other.closure)
+        return;
+    if (move)
+    {
+        move(other.closure, &storage);
+        closure = &storage;
+    }
+    else
+        closure = other.closure;
+    other.closure = nullptr;
+}
+
+void ThreadPool::Task::operator()()
+{
+    try
+    {
+        call(closure);
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+        return;
+    }
+    promise.set_value();
+}
+
+void ThreadPool::Task::clear()
+{
+    if (closure)
+    {
+        destroy(closure);
+        closure = nullptr;
+    }
+    // Перенос во временный объект отпускает общее состояние,
+    // не создавая нового, как сделало бы присваивание std::promise<void>()
+    std::promise<void> released(std::move(promise));
+}
+
+
 // Конструктор для инициализации пула потоков с заданным количеством потоков
 ThreadPool::ThreadPool(size_t threads) : stop(false)
 {
     for (size_t i = 0; i < threads; ++i)
-        workers.emplace_back([this]
-                             { run(); });
+        workers.emplace_back([this, i]
+                             { run(i); });
 }
 
 // Деструктор завершает работу потоков
@@ -63,4 +149,11 @@ ThreadPool::~ThreadPool()
     for (std::thread &worker : workers)
         if (worker.joinable())
             worker.join();
+
+    // Задачи, которые так и не начали выполняться
+    while (!tasks.empty())
+    {
+        taskPool.release(tasks.front());
+        tasks.pop();
+    }
 }
\ No newline at end of file
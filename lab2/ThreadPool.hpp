@@ -7,6 +7,11 @@
 #include <future>
 #include <mutex>
 #include <condition_variable>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include "Arena.hpp"
+#include "Trace.hpp"
 
 enum Point
 {
@@ -14,6 +19,7 @@ enum Point
     FILE_WRITING_CHOICE,
     EXIT_CHOICE,
     DESCRIPTION_CHOICE,
+    STATS_CHOICE,
 
 };
 
@@ -32,16 +38,126 @@ public:
     ThreadPool(ThreadPool &&) = delete;
     ThreadPool &operator=(ThreadPool &&) = delete;
 
-    // Метод для добавления задачи в пул и получения результата через future
-    std::future<void> enqueue(std::function<void()> task);
+    // Метод для добавления задачи в пул и получения результата через future.
+    // label - подпись задачи в трассировке (строковый литерал)
+    template <typename F>
+    std::future<void> enqueue(F task, const char *label = "task");
+
+    // Повторное использование ячеек очереди задач вместе с замыканиями в них:
+    // вызов malloc - новая ячейка или замыкание, не поместившееся в ячейку
+    ArenaStats slotStats();
+
+    // Повторное использование общих состояний future (общий пул на все ThreadPool)
+    static ArenaStats stateStats();
 
 private:
-    // Метод, выполняющий задачи в потоках
-    void run();
+    // Задача в очереди. Замыкание до gInlineClosure байт лежит прямо в ячейке,
+    // общее состояние future берется из пула блоков, а сами ячейки
+    // переиспользуются через пул объектов, так что постановка задачи
+    // обходится без malloc. Замыкания крупнее уходят в кучу.
+    class Task
+    {
+    public:
+        static const size_t gInlineClosure = 64;
+
+        template <typename F>
+        Task(F &&f, std::promise<void> &&promise, const char *label, uint64_t id);
+        Task(Task &&other);
+        ~Task() { clear(); }
+
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        // Выполнить замыкание и передать в future результат или исключение
+        void operator()();
+        // Разрушить замыкание и отпустить общее состояние
+        void clear();
+        // Лежит ли замыкание в самой ячейке
+        bool inlined() const { return move != nullptr; }
+
+        const char *label; // Подпись для трассировки
+        uint64_t id;       // Номер задачи в трассировке
+
+    private:
+        template <typename F>
+        static void callClosure(void *f) { (*static_cast<F *>(f))(); }
+        template <typename F>
+        static void moveClosure(void *from, void *to)
+        {
+            new (to) F(std::move(*static_cast<F *>(from)));
+            static_cast<F *>(from)->~F();
+        }
+        template <typename F>
+        static void destroyInline(void *f) { static_cast<F *>(f)->~F(); }
+        template <typename F>
+        static void destroyHeap(void *f) { delete static_cast<F *>(f); }
+
+        // Размещение замыкания: в storage, если помещается, иначе в куче
+        template <typename Closure, typename F>
+        void emplace(F &&f, std::true_type);
+        template <typename Closure, typename F>
+        void emplace(F &&f, std::false_type);
+
+        typename std::aligned_storage<gInlineClosure, alignof(std::max_align_t)>::type storage;
+        void *closure;                      // Замыкание в storage или в куче, nullptr - пусто
+        void (*call)(void *);               // Вызов замыкания
+        void (*move)(void *from, void *to); // Перенос замыкания из storage, nullptr - оно в куче
+        void (*destroy)(void *);            // Разрушение замыкания
+        std::promise<void> promise;
+    };
+
+    // Метод, выполняющий задачи в потоках; index - номер рабочего потока
+    void run(size_t index);
+
+    // Постановка готовой задачи в очередь
+    void push(Task &&task);
+
+    // Пул общих состояний future, один на процесс
+    static BlockPool &statePool();
 
     std::vector<std::thread> workers;        // Вектор рабочих потоков
-    std::queue<std::function<void()>> tasks; // Очередь задач
+    std::queue<Task *> tasks;                // Очередь задач
+    ObjectPool<Task> taskPool;               // Пул ячеек задач, защищен queueMutex
+    StatCounter heapClosures;                // Замыкания, не поместившиеся в ячейку, пишется под queueMutex
     std::mutex queueMutex;                   // Мьютекс для защиты очереди задач
     std::condition_variable condition;       // Условная переменная для синхронизации
     bool stop;                               // Флаг остановки пула потоков
 };
+
+template <typename F>
+ThreadPool::Task::Task(F &&f, std::promise<void> &&promise, const char *label, uint64_t id)
+    : label(label), id(id), call(&callClosure<typename std::decay<F>::type>), promise(std::move(promise))
+{
+    typedef typename std::decay<F>::type Closure;
+    typedef std::integral_constant<bool, sizeof(Closure) <= gInlineClosure && alignof(Closure) <= alignof(std::max_align_t) &&
+                                             std::is_nothrow_move_constructible<Closure>::value>
+        Fits;
+    emplace<Closure>(std::forward<F>(f), Fits());
+}
+
+template <typename Closure, typename F>
+void ThreadPool::Task::emplace(F &&f, std::true_type)
+{
+    closure = new (&storage) Closure(std::forward<F>(f));
+    move = &moveClosure<Closure>;
+    destroy = &destroyInline<Closure>;
+}
+
+template <typename Closure, typename F>
+void ThreadPool::Task::emplace(F &&f, std::false_type)
+{
+    closure = new Closure(std::forward<F>(f));
+    move = nullptr;
+    destroy = &destroyHeap<Closure>;
+}
+
+template <typename F>
+std::future<void> ThreadPool::enqueue(F task, const char *label)
+{
+    uint64_t id = TRACE_NEXT_ID();
+    TRACE_EVENT(ENQUEUE, label, id);
+    std::promise<void> promise(std::allocator_arg, PoolAllocator<char>(statePool()));
+    std::future<void> res = promise.get_future();
+    push(Task(std::move(task), std::move(promise), label, id));
+    return res;
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Трассировка жизненного цикла задач в формате Chrome trace (JSON), который
+// открывается в chrome://tracing и ui.perfetto.dev.
+// Каждый поток пишет события в свой кольцевой буфер без блокировок;
+// мьютекс берется только при первом событии потока и при сбросе в файл.
+// Макросы TRACE_* работают только при сборке с -DENABLE_TRACE, иначе
+// разворачиваются в пустоту.
+
+namespace trace
+{
+    enum Phase : uint8_t
+    {
+        ENQUEUE, // Задача поставлена в очередь
+        START,   // Задача (или участок кода) начала выполняться
+        END,     // Задача (или участок кода) завершилась
+    };
+
+    struct Event
+    {
+        uint64_t ts;       // Время в наносекундах (steady_clock)
+        uint64_t id;       // Номер задачи, 0 - просто участок кода
+        const char *label; // Подпись: должна жить до сброса в файл (строковый литерал)
+        uint32_t tid;      // Номер потока
+        Phase phase;
+    };
+
+    // Кольцевой буфер событий. Пишет один поток, при переполнении
+    // затираются самые старые события.
+    struct Ring
+    {
+        static const size_t gCapacity = 1 << 15;
+
+        Ring() : events(new Event[gCapacity]), head(0) {}
+
+        std::unique_ptr<Event[]> events;
+        std::atomic<size_t> head;
+    };
+
+    struct Registry
+    {
+        Registry() : nextTid(0), nextId(1), enabled(false), epoch(std::chrono::steady_clock::now()) {}
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Ring>> rings; // Все буферы, включая освободившиеся
+        std::vector<Ring *> free;                 // Буферы завершившихся потоков, их забирают новые потоки
+        std::map<uint32_t, std::string> names;    // Имена потоков
+        std::atomic<uint32_t> nextTid;
+        std::atomic<uint64_t> nextId;
+        std::atomic<bool> enabled;
+        std::chrono::steady_clock::time_point epoch;
+    };
+
+    inline Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    // Буфер и номер текущего потока. Буфер берется при первом событии,
+    // а при завершении потока возвращается в реестр: события в нем остаются,
+    // потоки std::async не плодят новых буферов.
+    struct ThreadState
+    {
+        ThreadState() : ring(nullptr), tid(registry().nextTid++) {}
+
+        ~ThreadState()
+        {
+            if (!ring)
+                return;
+            Registry &reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.free.push_back(ring);
+        }
+
+        Ring *attach()
+        {
+            Registry &reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            if (!reg.free.empty())
+            {
+                ring = reg.free.back();
+                reg.free.pop_back();
+            }
+            else
+            {
+                reg.rings.emplace_back(new Ring());
+                ring = reg.rings.back().get();
+            }
+            return ring;
+        }
+
+        Ring *ring;
+        uint32_t tid;
+    };
+
+    inline ThreadState &threadState()
+    {
+        static thread_local ThreadState state;
+        return state;
+    }
+
+    inline void enable(bool on = true)
+    {
+        registry().enabled.store(on, std::memory_order_relaxed);
+    }
+
+    inline bool enabled()
+    {
+        return registry().enabled.load(std::memory_order_relaxed);
+    }
+
+    // Новый номер задачи для связи событий постановки, начала и конца
+    inline uint64_t nextId()
+    {
+        return registry().nextId.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline void record(Phase phase, const char *label, uint64_t id = 0)
+    {
+        if (!enabled())
+            return;
+        ThreadState &state = threadState();
+        Ring *ring = state.ring ? state.ring : state.attach();
+        size_t head = ring->head.load(std::memory_order_relaxed);
+        Event &event = ring->events[head & (Ring::gCapacity - 1)];
+        event.ts = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        event.id = id;
+        event.label = label;
+        event.tid = state.tid;
+        event.phase = phase;
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+    inline void setThreadName(const std::string &name)
+    {
+        Registry &reg = registry();
+        uint32_t tid = threadState().tid;
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.names[tid] = name;
+    }
+
+    // Участок кода: START при входе в область видимости, END при выходе
+    class Span
+    {
+    public:
+        explicit Span(const char *label) : label(label) { record(START, label); }
+        ~Span() { record(END, label); }
+
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+    private:
+        const char *label;
+    };
+
+    inline void writeLabel(FILE *out, const char *label)
+    {
+        std::fputc('"', out);
+        for (const char *c = label ? label : ""; *c; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+                std::fputc('\\', out);
+            std::fputc(*c, out);
+        }
+        std::fputc('"', out);
+    }
+
+    // Сброс всех буферов в JSON-файл. Вызывать, когда трассируемая работа
+    // закончилась: буферы читаются без остановки пишущих потоков.
+    // Ожидание в очереди пишется асинхронным интервалом (b/e) с id задачи,
+    // выполнение - интервалом B/E на потоке-исполнителе.
+    inline bool flush(const std::string &path)
+    {
+        FILE *out = std::fopen(path.c_str(), "w");
+        if (!out)
+            return false;
+
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        uint64_t epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(reg.epoch.time_since_epoch()).count();
+        const char *separator = "\n";
+
+        std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+        for (std::map<uint32_t, std::string>::const_iterator it = reg.names.begin(); it != reg.names.end(); ++it)
+        {
+            std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", separator, it->first);
+            writeLabel(out, it->second.c_str());
+            std::fputs("}}", out);
+            separator = ",\n";
+        }
+        for (size_t r = 0; r < reg.rings.size(); ++r)
+        {
+            const Ring &ring = *reg.rings[r];
+            size_t head = ring.head.load(std::memory_order_acquire);
+            size_t first = head > Ring::gCapacity ? head - Ring::gCapacity : 0;
+            for (size_t i = first; i < head; ++i)
+            {
+                const Event &event = ring.events[i & (Ring::gCapacity - 1)];
+                double ts = (event.ts - epoch) / 1000.0;
+                const char *phases[2] = {nullptr, nullptr};
+                if (event.phase == ENQUEUE)
+                    phases[0] = "b";
+                else if (event.phase == START)
+                {
+                    phases[0] = "B";
+                    phases[1] = event.id ? "e" : nullptr;
+                }
+                else
+                    phases[0] = "E";
+
+                for (int p = 0; p < 2 && phases[p]; ++p)
+                {
+                    bool async = phases[p][0] == 'b' || phases[p][0] == 'e';
+                    std::fprintf(out, "%s{\"name\":", separator);
+                    writeLabel(out, event.label);
+                    std::fprintf(out, ",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u",
+                                 async ? "queue" : "task", phases[p], ts, event.tid);
+                    if (async)
+                        std::fprintf(out, ",\"id\":%llu", static_cast<unsigned long long>(event.id));
+                    else if (event.id)
+                        std::fprintf(out, ",\"args\":{\"task\":%llu}", static_cast<unsigned long long>(event.id));
+                    std::fputc('}', out);
+                    separator = ",\n";
+                }
+            }
+        }
+        std::fputs("\n]}\n", out);
+        return std::fclose(out) == 0;
+    }
+
+    // Включает трассировку на время жизни объекта и сбрасывает ее в файл
+    // в деструкторе. Объявляется раньше пула потоков, чтобы сброс шел
+    // после того, как пул остановится. Пустой путь - трассировка выключена.
+    class Session
+    {
+    public:
+        explicit Session(const std::string &path) : path(path)
+        {
+            if (!path.empty())
+                enable();
+        }
+
+        ~Session()
+        {
+            if (path.empty())
+                return;
+            enable(false);
+            if (!flush(path))
+                std::fprintf(stderr, "Не удалось записать трассировку в %s\n", path.c_str());
+        }
+
+        Session(const Session &) = delete;
+        Session &operator=(const Session &) = delete;
+
+    private:
+        std::string path;
+    };
+}
+
+#ifdef ENABLE_TRACE
+#define TRACE_EVENT(phase, label, id) trace::record(trace::phase, label, id)
+#define TRACE_SPAN(label) trace::Span traceSpan(label)
+#define TRACE_NEXT_ID() trace::nextId()
+#define TRACE_THREAD_NAME(name) trace::setThreadName(name)
+#define TRACE_SESSION(path) trace::Session traceSession(path)
+#else
+#define TRACE_EVENT(phase, label, id) ((void)0)
+#define TRACE_SPAN(label) ((void)0)
+#define TRACE_NEXT_ID() uint64_t(0)
+#define TRACE_THREAD_NAME(name) ((void)sizeof(name))
+#define TRACE_SESSION(path) ((void)0)
+#endif
@@ -25,14 +25,20 @@ void writeToFile(const std::string &filename, const std::string &content)
     }
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+    // ./lab2 --trace <файл>: при сборке с make TRACE=1 записать трассировку задач
+    // в формате Chrome trace. Сессия объявлена до пула, поэтому файл пишется после его остановки
+    std::string tracePath = argc == 3 && std::string(argv[1]) == "--trace" ? argv[2] : "";
+    TRACE_SESSION(tracePath);
+    TRACE_THREAD_NAME("main");
+
     ThreadPool pool;
     int choice;
     bool program = true;
     while (program)
     {
-        std::cout << "Выберите команду (1: Фибоначчи, 2: Запись в файл, 3: Выход, 4: Описание работы программы): ";
+        std::cout << "Выберите команду (1: Фибоначчи, 2: Запись в файл, 3: Выход, 4: Описание работы программы, 5: Статистика памяти): ";
         std::cin >> choice;
 
         switch (choice)
@@ -46,7 +52,7 @@ int main()
             pool.enqueue([n]()
                          {
                 long long fibResult = fibonacci(n);
-                std::cout << "Число Фибоначчи для " << n << ": " << fibResult << std::endl; });
+                std::cout << "Число Фибоначчи для " << n << ": " << fibResult << std::endl; }, "fibonacci");
             break;
         }
         case FILE_WRITING_CHOICE:
@@ -59,7 +65,7 @@ int main()
             std::getline(std::cin, content);
 
             pool.enqueue([filename, content]()
-                         { writeToFile(filename, content); });
+                         { writeToFile(filename, content); }, "write file");
             break;
         }
         case DESCRIPTION_CHOICE:
@@ -71,6 +77,16 @@ int main()
             std::cout << "Когда расчет числа Фибоначчи завершится, результат будет выведен на экран.\n";
             break;
         }
+        case STATS_CHOICE:
+        {
+            ArenaStats slots = pool.slotStats();
+            std::cout << "Ячейки задач и замыкания: выдано " << slots.allocations << ", из них без malloc " << slots.mallocAvoided
+                      << ", вызовов malloc " << slots.mallocCalls << "\n";
+            ArenaStats states = pool.stateStats();
+            std::cout << "Общие состояния future: выдано " << states.allocations << ", из них без malloc " << states.mallocAvoided
+                      << ", вызовов malloc " << states.mallocCalls << ", байт переиспользовано " << states.bytesReused << "\n";
+            break;
+        }
         case EXIT_CHOICE:
         {
             program = false;
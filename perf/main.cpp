@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../lab1/QuickSort.hpp"
+#include "../lab1/RadixSort.hpp"
+#include "../lab2/ThreadPool.hpp"
+
+// Набор фиксированных нагрузок для отслеживания масштабируемости.
+// Каждая нагрузка идет около секунды на одном потоке, чтобы шум планировщика
+// не влиял на результат, и прогоняется на 1..hardware_concurrency рабочих потоках,
+// по времени считаются ускорение T(1)/T(n) и эффективность ускорение/n.
+// Эффективность на 2+ потоках сравнивается с сохраненной базой по порогу,
+// время на одном потоке - по отдельному, более свободному порогу. При
+// регрессии программа завершается с кодом 1. Если в базе нет записи для
+// какой-то нагрузки или числа потоков этой машины, база устарела - код 3.
+
+const size_t gRepeats = 5; // Сколько раз повторять замер, берется медиана
+
+// Нагрузка: принимает число рабочих потоков, возвращает время в секундах
+struct Workload
+{
+    std::string name;
+    std::function<double(size_t)> run;
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Та же нагрузка, что в lab2
+long long fibonacci(int n)
+{
+    if (n <= 2)
+        return 1;
+    else
+        return fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+void wait_all(std::vector<std::future<void>> &futures)
+{
+    for (size_t i = 0; i < futures.size(); ++i)
+        futures[i].get();
+}
+
+// lab1: 32 массива по 400к элементов сортируются быстрой сортировкой как задачи пула
+double quick_sort_workload(size_t workers)
+{
+    std::vector<std::vector<int>> arrays(32, std::vector<int>(400000));
+    srand(1);
+    for (size_t a = 0; a < arrays.size(); ++a)
+        for (size_t i = 0; i < arrays[a].size(); ++i)
+            arrays[a][i] = rand();
+
+    ThreadPool pool(workers);
+    std::vector<std::future<void>> futures;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t a = 0; a < arrays.size(); ++a)
+    {
+        std::vector<int> *arr = &arrays[a];
+        futures.push_back(pool.enqueue([arr]
+                                       { quick_sort(*arr, 0, int(arr->size()) - 1); }, "quick sort"));
+    }
+    wait_all(futures);
+    return seconds_since(start);
+}
+
+// lab1: поразрядная сортировка 32 млн чисел на workers потоках
+double radix_sort_workload(size_t workers)
+{
+    std::vector<int> arr(32000000);
+    srand(2);
+    for (size_t i = 0; i < arr.size(); ++i)
+        arr[i] = rand();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    parallel_sort(arr, workers);
+    return seconds_since(start);
+}
+
+// lab2: 128 расчетов числа Фибоначчи
+double fibonacci_workload(size_t workers)
+{
+    ThreadPool pool(workers);
+    std::vector<std::future<void>> futures;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < 128; ++i)
+        futures.push_back(pool.enqueue([]
+                                       { volatile long long result = fibonacci(34); (void)result; }, "fibonacci"));
+    wait_all(futures);
+    return seconds_since(start);
+}
+
+// lab2: вперемешку расчеты Фибоначчи и запись файлов по 1 МБ
+double mix_workload(size_t workers)
+{
+    const std::string content(1024 * 1024, 'x');
+    ThreadPool pool(workers);
+    std::vector<std::future<void>> futures;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < 96; ++i)
+    {
+        futures.push_back(pool.enqueue([]
+                                       { volatile long long result = fibonacci(34); (void)result; }, "fibonacci"));
+        std::string filename = "perf_write_" + std::to_string(i) + ".txt";
+        futures.push_back(pool.enqueue([filename, &content]
+                                       {
+            std::ofstream file(filename);
+            file << content; }, "write file"));
+    }
+    wait_all(futures);
+    double elapsed = seconds_since(start);
+    for (size_t i = 0; i < 96; ++i)
+        std::remove(("perf_write_" + std::to_string(i) + ".txt").c_str());
+    return elapsed;
+}
+
+// Пропускная способность пула на пустых задачах: стоимость очереди и пробуждений.
+// 16 пачек по 100к задач, между пачками пул простаивает
+double empty_tasks_workload(size_t workers)
+{
+    ThreadPool pool(workers);
+    std::vector<std::future<void>> futures;
+    futures.reserve(100000);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t batch = 0; batch < 16; ++batch)
+    {
+        for (size_t i = 0; i < 100000; ++i)
+            futures.push_back(pool.enqueue([] {}, "empty"));
+        wait_all(futures);
+        futures.clear();
+    }
+    return seconds_since(start);
+}
+
+struct Result
+{
+    double seconds;
+    double speedup;
+    double efficiency;
+};
+
+// Ключ базы: "нагрузка/потоки"
+typedef std::map<std::string, Result> Results;
+
+std::string key(const std::string &name, size_t workers)
+{
+    return name + "/" + std::to_string(workers);
+}
+
+double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// Повторы идут по кругу по всем числам потоков, и ускорение считается по паре
+// T(1)/T(n) из одного повтора: так медленный дрейф скорости машины попадает
+// в обе части отношения и не искажает эффективность
+Results measure(const std::vector<Workload> &workloads, size_t maxWorkers)
+{
+    Results results;
+    std::printf("нагрузка       потоки     время, с  ускорение  эффективность\n");
+    for (size_t w = 0; w < workloads.size(); ++w)
+    {
+        std::vector<std::vector<double>> times(maxWorkers + 1);
+        for (size_t r = 0; r < gRepeats; ++r)
+            for (size_t workers = 1; workers <= maxWorkers; ++workers)
+                times[workers].push_back(workloads[w].run(workers));
+
+        for (size_t workers = 1; workers <= maxWorkers; ++workers)
+        {
+            std::vector<double> speedups;
+            for (size_t r = 0; r < gRepeats; ++r)
+                speedups.push_back(times[1][r] / times[workers][r]);
+            double speedup = median(speedups);
+
+            Result result = {median(times[workers]), speedup, speedup / workers};
+            results[key(workloads[w].name, workers)] = result;
+            std::printf("%-12s %8zu %12.4f %10.2f %14.2f\n", workloads[w].name.c_str(), workers, result.seconds, result.speedup, result.efficiency);
+        }
+    }
+    return results;
+}
+
+// Формат базы: строки "нагрузка потоки время ускорение эффективность", # - комментарий
+bool load_baseline(const std::string &path, Results &baseline)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream in(line);
+        std::string name;
+        size_t workers;
+        Result result;
+        if (in >> name >> workers >> result.seconds >> result.speedup >> result.efficiency)
+            baseline[key(name, workers)] = result;
+    }
+    return true;
+}
+
+bool save_baseline(const std::string &path, const std::vector<Workload> &workloads, size_t maxWorkers, Results &results)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+    file << "# База для make perf-check, пересоздается через make perf-baseline\n";
+    file << "# Записана на " << maxWorkers << " потоках\n";
+    file << "# нагрузка потоки время ускорение эффективность\n";
+    for (size_t w = 0; w < workloads.size(); ++w)
+    {
+        for (size_t workers = 1; workers <= maxWorkers; ++workers)
+        {
+            const Result &result = results[key(workloads[w].name, workers)];
+            file << workloads[w].name << " " << workers << " " << result.seconds << " " << result.speedup << " " << result.efficiency << "\n";
+        }
+    }
+    return true;
+}
+
+// Коды завершения проверки
+const int gOk = 0;
+const int gRegression = 1;
+const int gUsage = 2;
+const int gStale = 3;
+
+// Сравнение с базой. Регрессия: эффективность на 2+ потоках упала больше чем
+// на threshold (доля) или время на одном потоке выросло больше чем на
+// timeThreshold. Записи, которой нет в базе, - признак устаревшей базы.
+int check(const Results &results, const Results &baseline, double threshold, double timeThreshold)
+{
+    int regressions = 0;
+    int missing = 0;
+    for (Results::const_iterator it = results.begin(); it != results.end(); ++it)
+    {
+        Results::const_iterator base = baseline.find(it->first);
+        if (base == baseline.end())
+        {
+            std::printf("%-16s нет в базе\n", it->first.c_str());
+            ++missing;
+            continue;
+        }
+        bool single = it->first.substr(it->first.rfind('/') + 1) == "1";
+        bool regression = single ? it->second.seconds > base->second.seconds * (1 + timeThreshold)
+                                 : it->second.efficiency < base->second.efficiency * (1 - threshold);
+        std::printf("%-16s эффективность %.2f (база %.2f), время x%.2f от базы%s\n", it->first.c_str(),
+                    it->second.efficiency, base->second.efficiency, it->second.seconds / base->second.seconds,
+                    regression ? "  РЕГРЕССИЯ" : "");
+        if (regression)
+            ++regressions;
+    }
+    if (regressions > 0)
+        std::printf("Регрессий: %d\n", regressions);
+    else
+        std::printf("Регрессий нет\n");
+    if (missing > 0)
+    {
+        std::printf("База устарела: нет %d записей для этой машины, перезапишите ее: make perf-baseline\n", missing);
+        return gStale;
+    }
+    return regressions > 0 ? gRegression : gOk;
+}
+
+int main(int argc, char *argv[])
+{
+    // ./perf_check check <база> [порог [порог времени [потоки]]] - сравнить с базой
+    // ./perf_check record <база> [потоки]                        - записать новую базу
+    // потоки - наибольшее число рабочих потоков, по умолчанию hardware_concurrency
+    if (argc < 3 || (std::string(argv[1]) != "check" && std::string(argv[1]) != "record"))
+    {
+        std::cerr << "Использование: " << argv[0] << " check <база> [порог [порог времени [потоки]]] | record <база> [потоки]" << std::endl;
+        return gUsage;
+    }
+    std::string mode = argv[1], path = argv[2];
+    bool checkMode = mode == "check";
+    double threshold = checkMode && argc > 3 ? std::stod(argv[3]) : 0.15;
+    double timeThreshold = checkMode && argc > 4 ? std::stod(argv[4]) : 0.5;
+    int workersArg = checkMode ? 5 : 3;
+
+    size_t maxWorkers = argc > workersArg ? std::stoul(argv[workersArg]) : std::thread::hardware_concurrency();
+    if (maxWorkers == 0)
+        maxWorkers = 1;
+
+    std::vector<Workload> workloads = {
+        {"quick_sort", quick_sort_workload},
+        {"radix_sort", radix_sort_workload},
+        {"fibonacci", fibonacci_workload},
+        {"fib_write", mix_workload},
+        {"empty_tasks", empty_tasks_workload},
+    };
+    Results results = measure(workloads, maxWorkers);
+
+    if (mode == "record")
+    {
+        if (!save_baseline(path, workloads, maxWorkers, results))
+        {
+            std::cerr << "Не удалось записать базу " << path << std::endl;
+            return gUsage;
+        }
+        std::cout << "База записана в " << path << std::endl;
+        return 0;
+    }
+
+    Results baseline;
+    if (!load_baseline(path, baseline))
+    {
+        std::cerr << "Нет базы " << path << ", создайте ее: make perf-baseline" << std::endl;
+        return gStale;
+    }
+    return check(results, baseline, threshold, timeThreshold);
+}